@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <treemap/shardedtreemap.h>
+#include <treemap/treemap.h>
+#include <vector>
+
+namespace {
+constexpr int kInserts = 1 << 21;
+
+// TreeMap behind a single mutex, the baseline ShardedTreeMap replaces
+class LockedTreeMap {
+public:
+    void insert(const std::pair<const int, int>& data)
+    {
+        std::lock_guard lock(mutex_);
+        map_.insert(data);
+    }
+
+private:
+    std::mutex mutex_;
+    libcsc::TreeMap<int, int> map_;
+};
+
+// Inserts kInserts keys split between threads, returns millions of inserts
+// per second. Sequential keys give every thread its own contiguous block,
+// inserted in ascending order.
+template <typename Map>
+double run(int threads, bool sequential)
+{
+    Map map;
+    std::vector<std::vector<int>> keys(threads);
+    std::mt19937 random(1);
+    int block = kInserts / threads;
+    for (int t = 0; t < threads; t++) {
+        for (int i = t * block; i < (t + 1) * block; i++) {
+            keys[t].push_back(sequential ? i : static_cast<int>(random()));
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&map, &keys, t] {
+            for (int key : keys[t]) {
+                map.insert({key, key});
+            }
+        });
+    }
+    for (auto& it : workers) {
+        it.join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+    return kInserts / std::chrono::duration<double, std::micro>(finish - start)
+                              .count();
+}
+
+void row(int threads)
+{
+    std::printf(
+            "%-8d %10.2f %10.2f %10.2f %10.2f\n",
+            threads,
+            run<LockedTreeMap>(threads, false),
+            run<libcsc::ShardedTreeMap<int, int>>(threads, false),
+            run<LockedTreeMap>(threads, true),
+            run<libcsc::ShardedTreeMap<int, int>>(threads, true));
+}
+} // namespace
+
+int main()
+{
+    std::printf(
+            "Minserts/s on %u cores\n%-8s %10s %10s %10s %10s\n",
+            std::thread::hardware_concurrency(),
+            "threads",
+            "locked",
+            "sharded",
+            "locked seq",
+            "shard seq");
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        row(threads);
+    }
+    return 0;
+}
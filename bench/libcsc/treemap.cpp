@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <treemap/treemap.h>
+#include <vector>
+
+namespace {
+constexpr int kSize = 1 << 18;
+constexpr int kOperations = 1 << 21;
+
+// Runs kOperations on a map of about kSize keys, read_percent of them are
+// lookups and the rest are evenly split between insert and erase
+template <typename Balance>
+double run(int read_percent)
+{
+    std::mt19937 random(1);
+    libcsc::TreeMap<int, int, Balance> tree;
+    for (int i = 0; i < kSize; i++) {
+        tree.insert({static_cast<int>(random() % (2 * kSize)), i});
+    }
+    std::vector<int> keys(kOperations);
+    std::vector<int> kinds(kOperations);
+    for (int i = 0; i < kOperations; i++) {
+        keys[i] = static_cast<int>(random() % (2 * kSize));
+        kinds[i] = static_cast<int>(random() % 100);
+    }
+
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kOperations; i++) {
+        if (kinds[i] < read_percent) {
+            found += tree.count(keys[i]);
+        } else if (kinds[i] % 2 == 0) {
+            tree.insert({keys[i], i});
+        } else {
+            tree.erase(keys[i]);
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    if (found == static_cast<std::size_t>(-1)) {
+        std::printf("unreachable\n");
+    }
+    return std::chrono::duration<double, std::nano>(finish - start).count()
+            / kOperations;
+}
+
+// Sixteen random lowercase letters and digits
+std::string random_string(std::mt19937& random)
+{
+    const char alphabet[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    std::string result;
+    for (int i = 0; i < 16; i++) {
+        result += alphabet[random() % (sizeof(alphabet) - 1)];
+    }
+    return result;
+}
+
+// Looks up every key in a map holding all of keys, in random order
+template <typename KeyPrefix>
+double lookup(const std::vector<std::string>& keys)
+{
+    using StringTree = libcsc::
+            TreeMap<std::string, int, libcsc::AvlBalance, KeyPrefix>;
+    StringTree tree;
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        tree.insert({keys[i], static_cast<int>(i)});
+    }
+    std::vector<std::string> queries(keys);
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(2));
+
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& it : queries) {
+        found += tree.count(it);
+    }
+    auto finish = std::chrono::steady_clock::now();
+    if (found != queries.size()) {
+        std::printf("missing keys\n");
+    }
+    return std::chrono::duration<double, std::nano>(finish - start).count()
+            / static_cast<double>(queries.size());
+}
+
+// kSize random strings, each appended to one of prefixes
+std::vector<std::string> make_keys(const std::vector<std::string>& prefixes)
+{
+    std::mt19937 random(3);
+    std::vector<std::string> keys;
+    for (int i = 0; i < kSize; i++) {
+        keys.push_back(
+                prefixes[random() % prefixes.size()] + random_string(random));
+    }
+    return keys;
+}
+
+// kSize URLs of the form https://<host>.com/<id> over a number of hosts
+std::vector<std::string> make_urls(int hosts)
+{
+    std::mt19937 random(4);
+    std::vector<std::string> prefixes;
+    for (int i = 0; i < hosts; i++) {
+        prefixes.push_back(
+                "https://" + random_string(random).substr(0, 10) + ".com/");
+    }
+    return make_keys(prefixes);
+}
+
+void string_row(const char* name, const std::vector<std::string>& keys)
+{
+    std::printf(
+            "%-7s %12.1f %12.1f\n",
+            name,
+            lookup<libcsc::NoKeyPrefix>(keys),
+            lookup<libcsc::StringKeyPrefix>(keys));
+}
+
+// Adds batches random keys to a map of initial keys, either per element or
+// with insert_batch, and returns the time per added key
+double batch(int initial, int batches, int batch_size, bool batched)
+{
+    std::mt19937 random(5);
+    libcsc::TreeMap<int, int> tree;
+    for (int i = 0; i < initial; i++) {
+        tree.insert({static_cast<int>(random()), i});
+    }
+    std::vector<std::vector<std::pair<int, int>>> data(batches);
+    for (auto& it : data) {
+        for (int i = 0; i < batch_size; i++) {
+            it.emplace_back(static_cast<int>(random()), i);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto& it : data) {
+        if (batched) {
+            tree.insert_batch(it);
+        } else {
+            for (auto& pair : it) {
+                tree.insert(pair);
+            }
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count()
+            / (static_cast<double>(batches) * batch_size);
+}
+
+void batch_row(const char* name, int initial, int batches, int batch_size)
+{
+    std::printf(
+            "%-16s %10.1f %10.1f\n",
+            name,
+            batch(initial, batches, batch_size, false),
+            batch(initial, batches, batch_size, true));
+}
+
+template <typename Balance>
+void row(const char* name)
+{
+    std::printf(
+            "%-6s %12.1f %12.1f %12.1f\n",
+            name,
+            run<Balance>(90),
+            run<Balance>(50),
+            run<Balance>(0));
+}
+} // namespace
+
+int main()
+{
+    std::printf("ns/op  %12s %12s %12s\n", "read 90%", "read 50%", "churn");
+    row<libcsc::AvlBalance>("avl");
+    row<libcsc::WavlBalance>("wavl");
+
+    std::printf("\nns/find %12s %12s\n", "no prefix", "prefix");
+    string_row("ids", make_keys({""}));
+    string_row("urls", make_keys({"https://example.com/users/"}));
+    string_row("hosts", make_urls(4096));
+
+    std::printf("\nns/key %20s %10s\n", "insert", "batch");
+    batch_row("1M into empty", 0, 1, 1 << 20);
+    batch_row("100x10k into 1M", 1 << 20, 100, 10000);
+    batch_row("2x250k into 1M", 1 << 20, 2, 250000);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+namespace libcsc {
+// FrozenTreeMap
+//
+// Immutable map with the read API of TreeMap. Elements are sorted into a
+// flat array when the map is built, so a constexpr map costs no startup time
+// and no heap allocation; lookups are binary searches over contiguous memory.
+template <typename KeyType, typename ValueType, std::size_t N>
+class FrozenTreeMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = const value_type&;
+    using const_reference = const value_type&;
+
+    using iterator = const value_type*;
+    using const_iterator = const value_type*;
+
+private:
+    std::array<value_type, N> data_{};
+
+public:
+    constexpr explicit FrozenTreeMap(const value_type (&list)[N])
+    {
+        std::copy(list, list + N, data_.begin());
+        std::sort(
+                data_.begin(),
+                data_.end(),
+                [](const value_type& lhs, const value_type& rhs) {
+                    return lhs.first < rhs.first;
+                });
+        for (size_type i = 1; i < N; i++) {
+            if (!(data_[i - 1].first < data_[i].first)) {
+                throw std::invalid_argument("FrozenTreeMap duplicate key");
+            }
+        }
+    }
+
+    constexpr const mapped_type& at(const key_type& key) const
+    {
+        auto it = find(key);
+        if (it == cend()) {
+            throw std::out_of_range("at");
+        }
+        return it->second;
+    }
+
+    constexpr const_iterator begin() const noexcept
+    {
+        return data_.data();
+    }
+
+    constexpr const_iterator end() const noexcept
+    {
+        return data_.data() + N;
+    }
+
+    constexpr const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    constexpr const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return N;
+    }
+
+    constexpr bool empty() const noexcept
+    {
+        return N == 0;
+    }
+
+    constexpr const_iterator lower_bound(const key_type& key) const
+    {
+        size_type first = 0;
+        size_type count = N;
+        while (count > 0) {
+            size_type step = count / 2;
+            if (data_[first + step].first < key) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return begin() + first;
+    }
+
+    constexpr const_iterator upper_bound(const key_type& key) const
+    {
+        auto it = lower_bound(key);
+        if (it != cend() && !(key < it->first)) {
+            ++it;
+        }
+        return it;
+    }
+
+    constexpr const_iterator find(const key_type& key) const
+    {
+        auto it = lower_bound(key);
+        if (it == cend() || key < it->first) {
+            return cend();
+        }
+        return it;
+    }
+
+    constexpr bool contains(const key_type& key) const
+    {
+        return find(key) != cend();
+    }
+
+    constexpr size_type count(const key_type& key) const
+    {
+        return contains(key) ? 1 : 0;
+    }
+};
+
+template <typename KeyType, typename ValueType, std::size_t N>
+constexpr FrozenTreeMap<KeyType, ValueType, N>
+make_frozen_treemap(const std::pair<KeyType, ValueType> (&list)[N])
+{
+    return FrozenTreeMap<KeyType, ValueType, N>(list);
+}
+
+} // namespace libcsc
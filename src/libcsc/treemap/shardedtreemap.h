@@ -0,0 +1,500 @@
+#pragma once
+
+#include "treemap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace libcsc {
+// ShardedTreeMap
+//
+// Splits the key space into ordered ranges, each one a TreeMap behind its own
+// mutex, so writers to different ranges do not contend. When a shard outgrows
+// its share of keys it is split, or its boundary with a smaller neighbour is
+// moved; only the shards involved are locked while their elements move.
+template <
+        typename KeyType,
+        typename ValueType,
+        typename Balance = AvlBalance,
+        typename KeyPrefix = NoKeyPrefix>
+class ShardedTreeMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+
+private:
+    using pair_type = std::pair<key_type, mapped_type>;
+    using map_type = TreeMap<key_type, mapped_type, Balance, KeyPrefix>;
+
+    struct Shard {
+        std::mutex mutex_;
+        map_type map_;
+        // Key range [lo_, hi_) owned by the shard, guarded by mutex_
+        std::optional<key_type> lo_;
+        std::optional<key_type> hi_;
+        bool retired_ = false;
+        // Size at which an insert checks the shard for skew, guarded by mutex_
+        size_type limit_ = 0;
+        // Copy of map_.size() readable without mutex_
+        std::atomic<size_type> size_ = 0;
+
+        bool owns(const key_type& key) const
+        {
+            return !retired_ && (!lo_ || !(key < *lo_))
+                    && (!hi_ || key < *hi_);
+        }
+
+        std::vector<pair_type> extract() const
+        {
+            std::vector<pair_type> data;
+            data.reserve(map_.size());
+            for (auto it = map_.cbegin(); it != map_.cend(); ++it) {
+                data.push_back(*it);
+            }
+            return data;
+        }
+
+        // Removes the count smallest, or largest, elements and returns them
+        // in key order
+        std::vector<pair_type> take(size_type count, bool largest)
+        {
+            std::vector<pair_type> data;
+            data.reserve(count);
+            if (largest) {
+                auto it = map_.cend();
+                for (size_type i = 0; i < count; i++) {
+                    data.push_back(*--it);
+                }
+                std::reverse(data.begin(), data.end());
+            } else {
+                auto it = map_.cbegin();
+                for (size_type i = 0; i < count; i++, ++it) {
+                    data.push_back(*it);
+                }
+            }
+            for (auto& pair : data) {
+                map_.erase(pair.first);
+            }
+            size_ = map_.size();
+            return data;
+        }
+
+        void append(std::span<const pair_type> data)
+        {
+            map_.insert_batch(data);
+            size_ = map_.size();
+        }
+    };
+
+    // Immutable routing table, replaced as a whole on every layout change.
+    // bounds_[i] is the smallest key routed to shards_[i + 1]. A replaced
+    // layout is freed once the last operation still using it finishes.
+    struct Layout {
+        std::vector<std::shared_ptr<Shard>> shards_;
+        std::vector<key_type> bounds_;
+
+        size_type index(const key_type& key) const
+        {
+            auto it = std::upper_bound(bounds_.begin(), bounds_.end(), key);
+            return it - bounds_.begin();
+        }
+    };
+
+    // A shard is skewed once it holds kSkewFactor times its fair share, or
+    // kGrowFactor times while there are fewer than shard_count shards
+    static constexpr size_type kSkewFactor = 4;
+    static constexpr size_type kGrowFactor = 2;
+    static constexpr size_type kMinShardSize = 512;
+    static constexpr size_type kScanChunk = 256;
+
+    size_type shard_count_;
+    std::shared_ptr<const Layout> layout_;
+    // Guards layout_ only while the pointer is copied. libstdc++ 12's
+    // std::atomic<std::shared_ptr> releases its lock with relaxed order on
+    // load, which races with a concurrent store.
+    mutable std::shared_mutex layout_mutex_;
+    // Serializes layout changes, never taken by readers or writers
+    std::mutex rebalance_mutex_;
+
+    std::shared_ptr<const Layout> current_layout() const
+    {
+        std::shared_lock lock(layout_mutex_);
+        return layout_;
+    }
+
+    // Runs operation on the shard owning key. A shard reached through a
+    // stale layout no longer owns the key, so the layout is loaded again.
+    template <typename Operation>
+    auto with_shard(const key_type& key, Operation operation) const
+    {
+        while (true) {
+            auto layout = current_layout();
+            Shard& target = *layout->shards_[layout->index(key)];
+            std::lock_guard lock(target.mutex_);
+            if (target.owns(key)) {
+                return operation(target);
+            }
+        }
+    }
+
+    size_type fair(const Layout& layout) const
+    {
+        size_type size = 0;
+        for (auto& it : layout.shards_) {
+            size += it->size_;
+        }
+        return std::max(size / shard_count_, kMinShardSize);
+    }
+
+    size_type limit(const Layout& layout) const
+    {
+        size_type factor = (layout.shards_.size() < shard_count_)
+                ? kGrowFactor
+                : kSkewFactor;
+        return factor * fair(layout);
+    }
+
+    void publish(
+            std::vector<std::shared_ptr<Shard>> shards,
+            std::vector<key_type> bounds)
+    {
+        auto layout = std::make_shared<Layout>();
+        layout->shards_ = std::move(shards);
+        layout->bounds_ = std::move(bounds);
+        std::shared_ptr<const Layout> replaced = std::move(layout);
+        std::unique_lock lock(layout_mutex_);
+        layout_.swap(replaced);
+    }
+
+    // Splits the shard at index in two halves, caller holds its mutex
+    void split(const Layout& layout, size_type index, size_type new_limit)
+    {
+        Shard& lower = *layout.shards_[index];
+        auto data = lower.take(lower.map_.size() / 2, true);
+        auto upper = std::make_shared<Shard>();
+        upper->append(data);
+        upper->lo_ = data.front().first;
+        upper->hi_ = lower.hi_;
+        upper->limit_ = new_limit;
+        lower.hi_ = data.front().first;
+        lower.limit_ = new_limit;
+
+        auto shards = layout.shards_;
+        auto bounds = layout.bounds_;
+        shards.insert(shards.begin() + index + 1, std::move(upper));
+        bounds.insert(bounds.begin() + index, data.front().first);
+        publish(std::move(shards), std::move(bounds));
+    }
+
+    // Moves the boundary between the shard at from and its neighbour at to so
+    // they hold equally many keys, caller holds both mutexes. Only the keys
+    // crossing the boundary are moved. The neighbour was picked before its
+    // mutex was taken and may have grown since, then nothing is moved.
+    void move_bound(
+            const Layout& layout,
+            size_type from,
+            size_type to,
+            size_type new_limit)
+    {
+        Shard& source = *layout.shards_[from];
+        Shard& target = *layout.shards_[to];
+        if (source.map_.size() < target.map_.size() + 2) {
+            return;
+        }
+        size_type count = (source.map_.size() - target.map_.size()) / 2;
+        bool upward = from < to;
+        auto data = source.take(count, upward);
+        target.append(data);
+        key_type bound = upward ? data.front().first
+                                : source.map_.cbegin()->first;
+        if (upward) {
+            source.hi_ = bound;
+            target.lo_ = bound;
+        } else {
+            source.lo_ = bound;
+            target.hi_ = bound;
+        }
+        source.limit_ = new_limit;
+        target.limit_ = new_limit;
+
+        auto bounds = layout.bounds_;
+        bounds[std::min(from, to)] = bound;
+        publish(layout.shards_, std::move(bounds));
+    }
+
+    // Joins the shards at index and index + 1, caller holds both mutexes
+    void merge(const Layout& layout, size_type index)
+    {
+        Shard& lower = *layout.shards_[index];
+        Shard& upper = *layout.shards_[index + 1];
+        lower.append(upper.extract());
+        lower.hi_ = upper.hi_;
+        upper.retired_ = true;
+        upper.map_ = map_type();
+        upper.size_ = 0;
+
+        auto shards = layout.shards_;
+        auto bounds = layout.bounds_;
+        shards.erase(shards.begin() + index + 1);
+        bounds.erase(bounds.begin() + index);
+        publish(std::move(shards), std::move(bounds));
+    }
+
+    // Relieves the skewed shard owning key. Keys move to a neighbour holding
+    // under 1.5 times its fair share, the shard is split when there is none.
+    // Splitting past shard_count shards first joins the smallest pair of
+    // neighbours holding less than a fair share together.
+    void rebalance_at(const key_type& key)
+    {
+        std::lock_guard rebalance(rebalance_mutex_);
+        auto layout = current_layout();
+        size_type index = layout->index(key);
+        size_type new_limit = limit(*layout);
+        size_type share = fair(*layout);
+        Shard& target = *layout->shards_[index];
+
+        std::optional<size_type> neighbour;
+        if (layout->shards_.size() >= shard_count_) {
+            for (size_type it : {index - 1, index + 1}) {
+                if (it < layout->shards_.size()
+                    && 2 * layout->shards_[it]->size_ < 3 * share
+                    && (!neighbour
+                        || layout->shards_[it]->size_
+                                < layout->shards_[*neighbour]->size_)) {
+                    neighbour = it;
+                }
+            }
+        }
+
+        if (!neighbour && layout->shards_.size() >= shard_count_) {
+            std::optional<size_type> pair;
+            size_type pair_size = share;
+            for (size_type i = 0; i + 1 < layout->shards_.size(); i++) {
+                size_type size = layout->shards_[i]->size_
+                        + layout->shards_[i + 1]->size_;
+                if (i != index && i + 1 != index && size < pair_size) {
+                    pair = i;
+                    pair_size = size;
+                }
+            }
+            if (pair) {
+                {
+                    std::lock_guard lower_lock(layout->shards_[*pair]->mutex_);
+                    std::lock_guard upper_lock(
+                            layout->shards_[*pair + 1]->mutex_);
+                    merge(*layout, *pair);
+                }
+                layout = current_layout();
+                index = layout->index(key);
+            }
+        }
+
+        if (!neighbour) {
+            std::lock_guard lock(target.mutex_);
+            if (target.map_.size() <= new_limit) {
+                target.limit_ = new_limit;
+                return;
+            }
+            split(*layout, index, new_limit);
+            return;
+        }
+        size_type first = std::min(index, *neighbour);
+        std::lock_guard lower_lock(layout->shards_[first]->mutex_);
+        std::lock_guard upper_lock(layout->shards_[first + 1]->mutex_);
+        if (target.map_.size() <= new_limit) {
+            target.limit_ = new_limit;
+            return;
+        }
+        move_bound(*layout, index, *neighbour, new_limit);
+    }
+
+public:
+    // Starts with a single shard and splits it into shard_count ranges as the
+    // map grows
+    explicit ShardedTreeMap(size_type shard_count = 16)
+        : shard_count_(shard_count)
+    {
+        if (shard_count == 0) {
+            throw std::invalid_argument("ShardedTreeMap shard_count");
+        }
+        auto shard = std::make_shared<Shard>();
+        shard->limit_ = kGrowFactor * kMinShardSize;
+        publish({std::move(shard)}, {});
+    }
+
+    // Starts with fixed boundaries, bounds must be strictly increasing
+    explicit ShardedTreeMap(std::vector<key_type> bounds)
+        : shard_count_(bounds.size() + 1)
+    {
+        for (size_type i = 1; i < bounds.size(); i++) {
+            if (!(bounds[i - 1] < bounds[i])) {
+                throw std::invalid_argument("ShardedTreeMap bounds");
+            }
+        }
+        std::vector<std::shared_ptr<Shard>> shards;
+        for (size_type i = 0; i < shard_count_; i++) {
+            auto shard = std::make_shared<Shard>();
+            if (i > 0) {
+                shard->lo_ = bounds[i - 1];
+            }
+            if (i < bounds.size()) {
+                shard->hi_ = bounds[i];
+            }
+            shard->limit_ = kSkewFactor * kMinShardSize;
+            shards.push_back(std::move(shard));
+        }
+        publish(std::move(shards), std::move(bounds));
+    }
+
+    size_type size() const noexcept
+    {
+        auto layout = current_layout();
+        size_type size = 0;
+        for (auto& it : layout->shards_) {
+            size += it->size_;
+        }
+        return size;
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    size_type shard_count() const
+    {
+        return current_layout()->shards_.size();
+    }
+
+    bool insert(const value_type& data)
+    {
+        bool skewed = false;
+        bool inserted = with_shard(data.first, [&](Shard& target) {
+            bool result = target.map_.insert(data).second;
+            target.size_ = target.map_.size();
+            skewed = target.map_.size() > target.limit_;
+            return result;
+        });
+        if (skewed) {
+            rebalance_at(data.first);
+        }
+        return inserted;
+    }
+
+    void erase(const key_type& key)
+    {
+        with_shard(key, [&](Shard& target) {
+            target.map_.erase(key);
+            target.size_ = target.map_.size();
+        });
+    }
+
+    std::optional<mapped_type> find(const key_type& key) const
+    {
+        return with_shard(key, [&](Shard& target) {
+            auto it = target.map_.find(key);
+            if (it == target.map_.end()) {
+                return std::optional<mapped_type>();
+            }
+            return std::optional<mapped_type>(it->second);
+        });
+    }
+
+    bool contains(const key_type& key) const
+    {
+        return find(key).has_value();
+    }
+
+    size_type count(const key_type& key) const
+    {
+        return contains(key) ? 1 : 0;
+    }
+
+    // Calls callback for every element in key order. Elements are copied out
+    // of a shard in chunks and callback runs with no lock held, so it may use
+    // the map; writes made during the walk may or may not be visited.
+    template <typename Callback>
+    void for_each(Callback callback) const
+    {
+        std::vector<pair_type> chunk;
+        auto copy = [&](const value_type& data) { chunk.push_back(data); };
+        std::optional<key_type> cursor;
+        bool started = false;
+        while (!started || cursor) {
+            chunk.clear();
+            auto layout = current_layout();
+            size_type index = cursor ? layout->index(*cursor) : 0;
+            Shard& target = *layout->shards_[index];
+            std::optional<key_type> next;
+            {
+                std::lock_guard lock(target.mutex_);
+                bool owned = cursor ? target.owns(*cursor)
+                                    : !target.retired_ && !target.lo_;
+                if (!owned) {
+                    continue;
+                }
+                next = cursor ? target.map_.scan(*cursor, kScanChunk, copy)
+                              : target.map_.scan(kScanChunk, copy);
+                if (!next) {
+                    next = target.hi_;
+                }
+            }
+            for (auto& it : chunk) {
+                callback(it);
+            }
+            cursor = std::move(next);
+            started = true;
+        }
+    }
+
+    // Recomputes all shard boundaries so every shard holds an equal share of
+    // keys. Unlike automatic rebalancing this locks every shard.
+    void rebalance()
+    {
+        std::lock_guard rebalance(rebalance_mutex_);
+        auto layout = current_layout();
+        std::vector<std::unique_lock<std::mutex>> locks;
+        std::vector<pair_type> data;
+        for (auto& it : layout->shards_) {
+            locks.emplace_back(it->mutex_);
+            auto shard_data = it->extract();
+            data.insert(data.end(), shard_data.begin(), shard_data.end());
+            it->retired_ = true;
+            it->map_ = map_type();
+            it->size_ = 0;
+        }
+
+        size_type count = std::max<size_type>(
+                1, std::min(shard_count_, data.size()));
+        size_type new_limit
+                = kSkewFactor * std::max(data.size() / count, kMinShardSize);
+        std::vector<std::shared_ptr<Shard>> shards;
+        std::vector<key_type> bounds;
+        for (size_type i = 0; i < count; i++) {
+            size_type first = data.size() * i / count;
+            size_type last = data.size() * (i + 1) / count;
+            auto shard = std::make_shared<Shard>();
+            shard->append(std::span(data).subspan(first, last - first));
+            if (i > 0) {
+                bounds.push_back(data[first].first);
+                shard->lo_ = data[first].first;
+                shards.back()->hi_ = data[first].first;
+            }
+            shard->limit_ = new_limit;
+            shards.push_back(std::move(shard));
+        }
+        publish(std::move(shards), std::move(bounds));
+    }
+};
+
+} // namespace libcsc
@@ -1,14 +1,189 @@
 #pragma once
 
+#include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstdint>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 namespace libcsc {
+// Balancing policies
+//
+// Node::height_ holds the rank of the node. Insertion is shared by both
+// policies: a subtree is rotated when the ranks of its children differ by
+// two, and promote gives the new rank of a node on the insertion path.
+// erase_fixup restores the rank rule after a node has been unlinked from
+// parent; child is the subtree that took its place.
+
+// AVL: rank is the exact height, erase rotates on the whole path to the root
+struct AvlBalance {
+    static int promote(int /*rank*/, int left, int right)
+    {
+        return std::max(left, right) + 1;
+    }
+
+    // Recomputes the height of every node on the path and rotates where the
+    // children differ in height by two
+    template <typename Tree, typename Node>
+    static void erase_fixup(Tree& tree, Node* parent, Node* /*child*/)
+    {
+        while (parent != nullptr) {
+            Node* grand = parent->parent_;
+            Node* left = parent->left_;
+            Node* right = parent->right_;
+            Node* tree_root = parent;
+            parent->height_ =
+                    std::max(tree.height(left), tree.height(right)) + 1;
+            if (tree.height(left) - tree.height(right) == 2) {
+                tree_root = (tree.height(left->left_)
+                             >= tree.height(left->right_))
+                        ? tree.right_rotate(parent)
+                        : tree.leftRight_rotate(parent);
+            } else if (tree.height(right) - tree.height(left) == 2) {
+                tree_root = (tree.height(right->right_)
+                             >= tree.height(right->left_))
+                        ? tree.left_rotate(parent)
+                        : tree.rightLeft_rotate(parent);
+            }
+            tree.replace_child(grand, parent, tree_root);
+            parent = grand;
+        }
+    }
+};
+
+// Weak AVL: children may both be two ranks below their parent, so erase
+// mostly demotes and does at most two rotations per update
+struct WavlBalance {
+    static int promote(int rank, int left, int right)
+    {
+        return std::max(rank, std::max(left, right) + 1);
+    }
+
+    template <typename Tree, typename Node>
+    static void erase_fixup(Tree& tree, Node* parent, Node* child)
+    {
+        if (parent == nullptr) {
+            return;
+        }
+        if (child == nullptr && parent->left_ == nullptr
+            && parent->right_ == nullptr && parent->height_ == 1) {
+            parent->height_ = 0;
+            child = parent;
+            parent = parent->parent_;
+        }
+        while (parent != nullptr && parent->height_ - tree.height(child) == 3) {
+            bool left = parent->left_ == child;
+            Node* sibling = left ? parent->right_ : parent->left_;
+            if (parent->height_ - tree.height(sibling) == 2) {
+                parent->height_--;
+            } else if (
+                    sibling->height_ - tree.height(sibling->left_) == 2
+                    && sibling->height_ - tree.height(sibling->right_) == 2) {
+                parent->height_--;
+                sibling->height_--;
+            } else {
+                Node* grand = parent->parent_;
+                Node* outer = left ? sibling->right_ : sibling->left_;
+                Node* inner = left ? sibling->left_ : sibling->right_;
+                int parent_rank = parent->height_;
+                int sibling_rank = sibling->height_;
+                Node* tree_root;
+                if (sibling_rank - tree.height(outer) == 1) {
+                    tree_root = left ? tree.left_rotate(parent)
+                                     : tree.right_rotate(parent);
+                    sibling->height_ = sibling_rank + 1;
+                    parent->height_ = parent_rank - 1;
+                    if (parent->left_ == nullptr && parent->right_ == nullptr) {
+                        parent->height_ = 0;
+                    }
+                } else {
+                    int inner_rank = inner->height_;
+                    tree_root = left ? tree.rightLeft_rotate(parent)
+                                     : tree.leftRight_rotate(parent);
+                    inner->height_ = inner_rank + 2;
+                    sibling->height_ = sibling_rank - 1;
+                    parent->height_ = parent_rank - 2;
+                }
+                tree.replace_child(grand, parent, tree_root);
+                return;
+            }
+            child = parent;
+            parent = parent->parent_;
+        }
+    }
+};
+
+// Key prefix policies
+//
+// A Node caches prefix(key) next to its links. Prefixes are compared first
+// and the keys themselves only when prefixes are equal, so prefix must keep
+// the key order: prefix(a) < prefix(b) implies a < b.
+
+// No cached prefix, keys are compared directly
+struct NoKeyPrefix {
+    struct type {
+        constexpr bool operator<(const type& /*other*/) const
+        {
+            return false;
+        }
+    };
+
+    template <typename Key>
+    static type prefix(const Key& /*key*/)
+    {
+        return type();
+    }
+};
+
+// First sixteen bytes of a string key packed big-endian into two words, so
+// keys differing early are ordered without touching their heap buffers.
+// Sixteen bytes reach past a URL scheme such as "https://" into the host.
+struct StringKeyPrefix {
+    struct type {
+        std::uint64_t high_ = 0;
+        std::uint64_t low_ = 0;
+
+        constexpr bool operator<(const type& other) const
+        {
+            return high_ < other.high_
+                    || (high_ == other.high_ && low_ < other.low_);
+        }
+    };
+
+    template <typename Key>
+    static type prefix(const Key& key)
+    {
+        type result;
+        for (std::size_t i = 0; i < 2 * sizeof(std::uint64_t); i++) {
+            std::uint64_t& word = (i < sizeof(std::uint64_t)) ? result.high_
+                                                              : result.low_;
+            word <<= 8U;
+            if (i < key.size()) {
+                word |= static_cast<unsigned char>(key[i]);
+            }
+        }
+        return result;
+    }
+};
+
+// Access to the nodes of a TreeMap, only defined by tests checking the
+// balancing invariants
+template <typename Tree>
+struct TreeMapAccess;
+
 // TreeMap
-template <typename KeyType, typename ValueType>
+template <
+        typename KeyType,
+        typename ValueType,
+        typename Balance = AvlBalance,
+        typename KeyPrefix = NoKeyPrefix>
 class TreeMap {
 public:
     using key_type = KeyType;
@@ -25,8 +200,14 @@ public:
     using const_iterator = ConstIterator;
 
 private:
+    friend Balance;
+    friend struct TreeMapAccess<TreeMap>;
+
+    using prefix_type = typename KeyPrefix::type;
+
     struct Node {
         value_type data_;
+        [[no_unique_address]] prefix_type prefix_;
 
         Node* parent_ = nullptr;
         Node* left_ = nullptr;
@@ -39,7 +220,10 @@ private:
         }
 
         Node(key_type key, mapped_type value, Node* parent = nullptr)
-            : parent_(parent), left_(nullptr), right_(nullptr)
+            : prefix_(KeyPrefix::prefix(key)),
+              parent_(parent),
+              left_(nullptr),
+              right_(nullptr)
         {
             data_ = value_type(key, value);
             height_ = 0;
@@ -52,6 +236,7 @@ private:
                 Node* right = nullptr,
                 int height = 0)
             : data_(data),
+              prefix_(KeyPrefix::prefix(data_.first)),
               parent_(parent),
               left_(left),
               right_(right),
@@ -77,7 +262,33 @@ private:
     Node* root_ = nullptr;
     size_type size_ = 0;
 
-    int height(Node* node)
+    // Three-way comparison of key against the key of node
+    static int compare(
+            const key_type& key,
+            const prefix_type& prefix,
+            const Node* node)
+    {
+        if (prefix < node->prefix_) {
+            return -1;
+        }
+        if (node->prefix_ < prefix) {
+            return 1;
+        }
+        if constexpr (std::three_way_comparable<key_type>) {
+            auto order = key <=> node->data_.first;
+            return (order < 0) ? -1 : (order > 0) ? 1 : 0;
+        } else {
+            if (key < node->data_.first) {
+                return -1;
+            }
+            if (node->data_.first < key) {
+                return 1;
+            }
+            return 0;
+        }
+    }
+
+    static int height(Node* node)
     {
         return (node != nullptr) ? node->height_ : -1;
     }
@@ -132,21 +343,26 @@ private:
         return left_rotate(tree);
     }
 
-    Node* add(Node* tree, const value_type& data, iterator& iter)
+    Node* add(
+            Node* tree,
+            const value_type& data,
+            const prefix_type& prefix,
+            iterator& iter)
     {
-        if (tree->data_.first == data.first) {
+        int order = compare(data.first, prefix, tree);
+        if (order == 0) {
             this->size_--;
             iter = tree;
         }
-        if (data.first < tree->data_.first) {
+        if (order < 0) {
             if (tree->left_ == nullptr) {
                 tree->left_ = new Node(data, tree);
                 iter = tree->left_;
             } else {
-                tree->left_ = add(tree->left_, data, iter);
+                tree->left_ = add(tree->left_, data, prefix, iter);
             }
             if (std::abs(height(tree->left_) - height(tree->right_)) == 2) {
-                if (data.first < tree->left_->data_.first) {
+                if (compare(data.first, prefix, tree->left_) < 0) {
                     tree = right_rotate(tree);
                 } else {
                     tree = leftRight_rotate(tree);
@@ -154,22 +370,23 @@ private:
             }
         }
 
-        else if (data.first > tree->data_.first) {
+        else if (order > 0) {
             if (tree->right_ == nullptr) {
                 tree->right_ = new Node(data, tree);
                 iter = tree->right_;
             } else {
-                tree->right_ = add(tree->right_, data, iter);
+                tree->right_ = add(tree->right_, data, prefix, iter);
             }
             if (std::abs(height(tree->left_) - height(tree->right_)) == 2) {
-                if (data.first > tree->right_->data_.first) {
+                if (compare(data.first, prefix, tree->right_) > 0) {
                     tree = left_rotate(tree);
                 } else {
                     tree = rightLeft_rotate(tree);
                 }
             }
         }
-        tree->height_ = std::max(height(tree->left_), height(tree->right_)) + 1;
+        tree->height_ = Balance::promote(
+                tree->height_, height(tree->left_), height(tree->right_));
         return tree;
     }
 
@@ -184,39 +401,93 @@ private:
         size_ = 0;
     }
 
-    Node* change_data(Node* node, value_type& data)
-    {
-        if (node->parent_ == nullptr) {
-            node = new Node(
-                    data,
-                    node->parent_,
-                    node->left_,
-                    node->right_,
-                    node->height_);
-        } else if (node->parent_->left_ == node) {
-            node = new Node(
-                    data,
-                    node->parent_,
-                    node->left_,
-                    node->right_,
-                    node->height_);
-            node->parent_->left_ = node;
-        } else {
-            node = new Node(
-                    data,
-                    node->parent_,
-                    node->left_,
-                    node->right_,
-                    node->height_);
-            node->parent_->right_ = node;
+    // Batches at least 1/kBatchRebuildRatio of the tree size are merged by
+    // rebuilding the whole tree, smaller ones go through add in key order
+    static constexpr size_type kBatchRebuildRatio = 8;
+
+    void collect(Node* tree, std::vector<Node*>& nodes)
+    {
+        Node* node = tree;
+        std::vector<Node*> stack;
+        while (node != nullptr || !stack.empty()) {
+            while (node != nullptr) {
+                stack.push_back(node);
+                node = node->left_;
+            }
+            node = stack.back();
+            stack.pop_back();
+            nodes.push_back(node);
+            node = node->right_;
         }
-        if (node->left_) {
-            node->left_->parent_ = node;
+    }
+
+    Node* build(
+            std::vector<Node*>& nodes,
+            size_type first,
+            size_type last,
+            Node* parent)
+    {
+        if (first == last) {
+            return nullptr;
         }
-        if (node->right_) {
-            node->right_->parent_ = node;
+        size_type middle = first + (last - first) / 2;
+        Node* tree = nodes[middle];
+        tree->parent_ = parent;
+        tree->left_ = build(nodes, first, middle, tree);
+        tree->right_ = build(nodes, middle + 1, last, tree);
+        tree->height_ = std::max(height(tree->left_), height(tree->right_)) + 1;
+        return tree;
+    }
+
+    Node* lower_bound_node(const key_type& key) const
+    {
+        prefix_type prefix = KeyPrefix::prefix(key);
+        Node* node = root_;
+        Node* result = nullptr;
+        while (node != nullptr) {
+            if (compare(key, prefix, node) > 0) {
+                node = node->right_;
+            } else {
+                result = node;
+                node = node->left_;
+            }
+        }
+        return result;
+    }
+
+    template <typename Callback>
+    std::optional<key_type>
+    scan_from(Node* node, size_type max_items, Callback& callback) const
+    {
+        const_iterator it(node, this);
+        for (size_type i = 0; i < max_items && it != cend(); ++i, ++it) {
+            callback(*it);
+        }
+        if (it == cend()) {
+            return std::nullopt;
+        }
+        return it->first;
+    }
+
+    std::pair<size_type, std::optional<key_type>> scan_into(
+            Node* node,
+            std::span<std::pair<key_type, mapped_type>> buffer) const
+    {
+        size_type count = 0;
+        auto copy = [&](const value_type& data) { buffer[count++] = data; };
+        auto next = scan_from(node, buffer.size(), copy);
+        return std::make_pair(count, next);
+    }
+
+    void replace_child(Node* parent, Node* old_child, Node* new_child)
+    {
+        if (parent == nullptr) {
+            root_ = new_child;
+        } else if (parent->left_ == old_child) {
+            parent->left_ = new_child;
+        } else {
+            parent->right_ = new_child;
         }
-        return node;
     }
 
 public:
@@ -254,20 +525,29 @@ public:
 
     TreeMap& operator=(const TreeMap& other)
     {
+        if (this == &other) {
+            return *this;
+        }
         delete_tree(root_);
+        root_ = nullptr;
         for (auto it = other.cbegin(); it != other.cend(); ++it) {
             insert(*it);
         }
+        return *this;
     }
 
     TreeMap& operator=(TreeMap&& other) noexcept
     {
+        if (this == &other) {
+            return *this;
+        }
         delete_tree(root_);
         this->root_ = other.root_;
         this->size_ = other.size_;
 
         other.root_ = nullptr;
         other.size_ = 0;
+        return *this;
     }
 
     bool operator==(const TreeMap& other) const
@@ -312,35 +592,35 @@ public:
     iterator begin()
     {
         if (root_ == nullptr) {
-            return iterator(static_cast<Node*>(nullptr));
+            return end();
         }
         Node* node = root_;
         while (node->left_ != nullptr) {
             node = node->left_;
         }
-        return iterator(node);
+        return iterator(node, this);
     }
 
     iterator end()
     {
-        return iterator(static_cast<Node*>(nullptr));
+        return iterator(static_cast<Node*>(nullptr), this);
     }
 
     const_iterator cbegin() const
     {
         if (root_ == nullptr) {
-            return const_iterator(static_cast<Node*>(nullptr));
+            return cend();
         }
         Node* node = root_;
         while (node->left_ != nullptr) {
             node = node->left_;
         }
-        return const_iterator(node);
+        return const_iterator(node, this);
     }
 
     const_iterator cend() const
     {
-        return const_iterator(static_cast<Node*>(nullptr));
+        return const_iterator(static_cast<Node*>(nullptr), this);
     }
 
     size_type size() const noexcept
@@ -362,12 +642,12 @@ public:
         size_++;
         if (root_ == nullptr) {
             create(data);
-            return std::make_pair(iterator(root_), true);
+            return std::make_pair(iterator(root_, this), true);
 
         } else {
-            iterator iter;
+            iterator iter(this);
             auto old_size = size_;
-            root_ = add(root_, data, iter);
+            root_ = add(root_, data, KeyPrefix::prefix(data.first), iter);
             if (old_size == size_ + 1) {
                 return std::make_pair(iter, false);
             } else {
@@ -375,6 +655,94 @@ public:
             }
         }
     }
+
+    // Inserts every pair of an unsorted batch. Keys already in the map and
+    // repeated keys of the batch keep the first value, as with insert.
+    // Returns the number of inserted elements.
+    size_type
+    insert_batch(std::span<const std::pair<key_type, mapped_type>> batch)
+    {
+        using pair_type = std::pair<key_type, mapped_type>;
+        std::vector<const pair_type*> sorted;
+        sorted.reserve(batch.size());
+        for (auto& it : batch) {
+            sorted.push_back(&it);
+        }
+        auto less = [](const pair_type* lhs, const pair_type* rhs) {
+            return lhs->first < rhs->first;
+        };
+        auto equal = [](const pair_type* lhs, const pair_type* rhs) {
+            return lhs->first == rhs->first;
+        };
+        std::stable_sort(sorted.begin(), sorted.end(), less);
+        sorted.erase(
+                std::unique(sorted.begin(), sorted.end(), equal),
+                sorted.end());
+
+        auto old_size = size_;
+        if (sorted.size() * kBatchRebuildRatio < size_) {
+            for (auto it : sorted) {
+                insert(*it);
+            }
+            return size_ - old_size;
+        }
+
+        std::vector<Node*> nodes;
+        std::vector<Node*> merged;
+        nodes.reserve(size_);
+        merged.reserve(size_ + sorted.size());
+        collect(root_, nodes);
+        auto node = nodes.begin();
+        for (auto it : sorted) {
+            while (node != nodes.end() && (*node)->data_.first < it->first) {
+                merged.push_back(*node++);
+            }
+            if (node != nodes.end() && (*node)->data_.first == it->first) {
+                continue;
+            }
+            merged.push_back(new Node(*it));
+        }
+        merged.insert(merged.end(), node, nodes.end());
+
+        root_ = build(merged, 0, merged.size(), nullptr);
+        size_ = merged.size();
+        return size_ - old_size;
+    }
+
+    // Calls callback for at most max_items elements with keys not less than
+    // from_key, in key order. Returns the key to resume the scan from, or
+    // nullopt when the end of the map is reached. Only the key is kept
+    // between calls, so the map may be modified between chunks.
+    template <std::invocable<const value_type&> Callback>
+    std::optional<key_type> scan(
+            const key_type& from_key,
+            size_type max_items,
+            Callback callback) const
+    {
+        return scan_from(lower_bound_node(from_key), max_items, callback);
+    }
+
+    template <std::invocable<const value_type&> Callback>
+    std::optional<key_type> scan(size_type max_items, Callback callback) const
+    {
+        return scan_from(cbegin().node_, max_items, callback);
+    }
+
+    // Copies the next chunk starting at from_key into buffer. Returns the
+    // number of copied elements and the key to resume the scan from.
+    std::pair<size_type, std::optional<key_type>> scan(
+            const key_type& from_key,
+            std::span<std::pair<key_type, mapped_type>> buffer) const
+    {
+        return scan_into(lower_bound_node(from_key), buffer);
+    }
+
+    std::pair<size_type, std::optional<key_type>>
+    scan(std::span<std::pair<key_type, mapped_type>> buffer) const
+    {
+        return scan_into(cbegin().node_, buffer);
+    }
+
     void erase(iterator pos);
 
     void erase(const key_type& key)
@@ -384,11 +752,13 @@ public:
 
     iterator find(const key_type& key)
     {
+        prefix_type prefix = KeyPrefix::prefix(key);
         Node* node = root_;
         while (node != nullptr) {
-            if (key > node->data_.first) {
+            int order = compare(key, prefix, node);
+            if (order > 0) {
                 node = node->right_;
-            } else if (key < node->data_.first) {
+            } else if (order < 0) {
                 node = node->left_;
             } else {
                 break;
@@ -397,25 +767,27 @@ public:
         if (node == nullptr) {
             return end();
         } else {
-            return iterator(node);
+            return iterator(node, this);
         }
     }
     const_iterator find(const key_type& key) const
     {
+        prefix_type prefix = KeyPrefix::prefix(key);
         Node* node = root_;
         while (node != nullptr) {
-            if (key > node->data_.first) {
+            int order = compare(key, prefix, node);
+            if (order > 0) {
                 node = node->right_;
-            } else if (key < node->data_.first) {
+            } else if (order < 0) {
                 node = node->left_;
             } else {
                 break;
             }
         }
-        if (node->data_.first != key) {
+        if (node == nullptr) {
             return cend();
         } else {
-            return const_iterator(node);
+            return const_iterator(node, this);
         }
     }
 
@@ -439,8 +811,12 @@ public:
 };
 
 // Const_Iterator
-template <typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::ConstIterator {
+template <
+        typename KeyType,
+        typename ValueType,
+        typename Balance,
+        typename KeyPrefix>
+class TreeMap<KeyType, ValueType, Balance, KeyPrefix>::ConstIterator {
 public:
     using reference = typename TreeMap::const_reference;
     using iterator_category = std::bidirectional_iterator_tag;
@@ -449,15 +825,17 @@ public:
     using pointer = const typename TreeMap::value_type*;
 
 private:
-    friend class TreeMap<KeyType, ValueType>;
+    friend class TreeMap<KeyType, ValueType, Balance, KeyPrefix>;
     Node* node_ = nullptr;
+    // Lets operator-- step back from end() to the largest element
+    const TreeMap* tree_ = nullptr;
 
-    explicit ConstIterator(Node* node) : node_(node)
+    ConstIterator(Node* node, const TreeMap* tree) : node_(node), tree_(tree)
     {
     }
 
 public:
-    explicit ConstIterator(const TreeMap* tree = nullptr)
+    explicit ConstIterator(const TreeMap* tree = nullptr) : tree_(tree)
     {
         if (tree) {
             node_ = tree->root_;
@@ -499,7 +877,10 @@ public:
     ConstIterator& operator--()
     {
         if (node_ == nullptr) {
-            node_ = node_->parent_;
+            if (tree_ == nullptr || tree_->root_ == nullptr) {
+                throw std::out_of_range("operator--");
+            }
+            node_ = tree_->root_;
             while (node_->right_ != nullptr) {
                 node_ = node_->right_;
             }
@@ -554,12 +935,16 @@ public:
 };
 
 // Iterator
-template <typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::Iterator
-    : public TreeMap<KeyType, ValueType>::ConstIterator {
+template <
+        typename KeyType,
+        typename ValueType,
+        typename Balance,
+        typename KeyPrefix>
+class TreeMap<KeyType, ValueType, Balance, KeyPrefix>::Iterator
+    : public TreeMap<KeyType, ValueType, Balance, KeyPrefix>::ConstIterator {
 private:
-    friend class TreeMap<KeyType, ValueType>;
-    explicit Iterator(Node* node) : ConstIterator(node)
+    friend class TreeMap<KeyType, ValueType, Balance, KeyPrefix>;
+    Iterator(Node* node, TreeMap* tree) : ConstIterator(node, tree)
     {
     }
 
@@ -624,89 +1009,54 @@ public:
         return !(*this == other);
     }
 };
-template <typename KeyType, typename ValueType>
-void TreeMap<KeyType, ValueType>::erase(TreeMap::iterator pos)
+template <
+        typename KeyType,
+        typename ValueType,
+        typename Balance,
+        typename KeyPrefix>
+void TreeMap<KeyType, ValueType, Balance, KeyPrefix>::erase(
+        TreeMap::iterator pos)
 {
-    if (pos.node_ == nullptr) {
-        return;
-    }
-    if (pos.node_->parent_ == nullptr && pos.node_->left_ == nullptr
-        && pos.node_->right_ == nullptr) {
-        delete root_;
-        root_ = nullptr;
-        size_--;
+    Node* node = pos.node_;
+    if (node == nullptr) {
         return;
     }
-    if (pos.node_->left_ == nullptr || pos.node_->right_ == nullptr) {
-        Node* parent = pos.node_->parent_;
-        Node* temp = pos.node_->left_ ? pos.node_->left_ : pos.node_->right_;
-        if (temp == nullptr) {
-            if (parent->left_ == pos.node_) {
-                delete parent->left_;
-                parent->left_ = nullptr;
-            } else {
-                delete parent->right_;
-                parent->right_ = nullptr;
-            }
-
-        } else {
-            Node* newNode = change_data(pos.node_, temp->data_);
-            delete pos.node_;
-            pos.node_ = newNode;
-            pos.node_->height_ = 0;
-            delete pos.node_->left_;
-            delete pos.node_->right_;
-            pos.node_->left_ = nullptr;
-            pos.node_->right_ = nullptr;
-        }
-        if (parent == nullptr) {
-            root_ = pos.node_;
-        } else {
-            pos.node_ = parent;
-        }
-    } else {
-        Node* temp = pos.node_->left_;
+    Node* parent;
+    Node* child;
+    if (node->left_ != nullptr && node->right_ != nullptr) {
+        // Move the predecessor into the place of node
+        Node* temp = node->left_;
         while (temp->right_ != nullptr) {
             temp = temp->right_;
         }
-        Node* newNode = change_data(pos.node_, temp->data_);
-        delete pos.node_;
-        pos.node_ = newNode;
-        erase(iterator(temp));
-        size_++;
-    }
-
-    pos.node_->height_
-            = std::max(height(pos.node_->left_), height(pos.node_->right_)) + 1;
-
-    if (std::abs(height(pos.node_->left_) - height(pos.node_->right_)) == 2) {
-        if (height(pos.node_->left_) > height(pos.node_->right_)) {
-            if (pos.node_->data_.first > pos.node_->left_->data_.first) {
-                pos.node_ = right_rotate(pos.node_);
-            } else {
-                pos.node_ = leftRight_rotate(pos.node_);
-            }
-
-            if (pos.node_->parent_ == nullptr) {
-                this->root_ = pos.node_;
-                return;
-            }
-            pos.node_->parent_->right_ = pos.node_;
+        child = temp->left_;
+        if (temp->parent_ == node) {
+            parent = temp;
         } else {
-            if (pos.node_->data_.first < pos.node_->right_->data_.first) {
-                pos.node_ = left_rotate(pos.node_);
-            } else {
-                pos.node_ = rightLeft_rotate(pos.node_);
+            parent = temp->parent_;
+            parent->right_ = child;
+            if (child != nullptr) {
+                child->parent_ = parent;
             }
-
-            if (pos.node_->parent_ == nullptr) {
-                this->root_ = pos.node_;
-                return;
-            }
-            pos.node_->parent_->left_ = pos.node_;
+            temp->left_ = node->left_;
+            temp->left_->parent_ = temp;
+        }
+        temp->right_ = node->right_;
+        temp->right_->parent_ = temp;
+        temp->parent_ = node->parent_;
+        temp->height_ = node->height_;
+        replace_child(node->parent_, node, temp);
+    } else {
+        parent = node->parent_;
+        child = (node->left_ != nullptr) ? node->left_ : node->right_;
+        if (child != nullptr) {
+            child->parent_ = parent;
         }
+        replace_child(parent, node, child);
     }
+    delete node;
     size_--;
+    Balance::erase_fixup(*this, parent, child);
 }
 
 } // namespace libcsc
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <string_view>
+#include <treemap/frozentreemap.h>
+
+namespace {
+constexpr auto opcodes = libcsc::make_frozen_treemap<std::string_view, int>(
+        {{"mul", 3}, {"add", 1}, {"sub", 2}, {"div", 4}});
+} // namespace
+
+TEST(FrozenTreeMap, constexprTest)
+{
+    static_assert(opcodes.size() == 4);
+    static_assert(opcodes.at("sub") == 2);
+    static_assert(opcodes.contains("div"));
+    static_assert(!opcodes.contains("mod"));
+    ASSERT_EQ(3, opcodes.at("mul")); // NOLINT
+}
+
+TEST(FrozenTreeMap, orderTest)
+{
+    constexpr auto tree
+            = libcsc::make_frozen_treemap<int, int>({{3, 3}, {1, 1}, {2, 2}});
+    int expected = 1;
+    for (const auto& it : tree) {
+        ASSERT_EQ(expected, it.first); // NOLINT
+        expected++;
+    }
+}
+
+TEST(FrozenTreeMap, findTest)
+{
+    constexpr auto tree
+            = libcsc::make_frozen_treemap<int, int>({{3, 3}, {1, 1}, {2, 2}});
+    ASSERT_EQ(2, tree.find(2)->second);   // NOLINT
+    ASSERT_EQ(tree.cend(), tree.find(4)); // NOLINT
+    ASSERT_EQ(1, tree.count(1));          // NOLINT
+    ASSERT_EQ(0, tree.count(0));          // NOLINT
+}
+
+TEST(FrozenTreeMap, boundsTest)
+{
+    constexpr auto tree = libcsc::make_frozen_treemap<int, int>(
+            {{10, 1}, {30, 3}, {20, 2}});
+    ASSERT_EQ(20, tree.lower_bound(20)->first);   // NOLINT
+    ASSERT_EQ(30, tree.upper_bound(20)->first);   // NOLINT
+    ASSERT_EQ(10, tree.lower_bound(5)->first);    // NOLINT
+    ASSERT_EQ(tree.cend(), tree.upper_bound(30)); // NOLINT
+}
+
+TEST(FrozenTreeMap, atTest)
+{
+    constexpr auto tree = libcsc::make_frozen_treemap<int, int>({{1, 1}});
+    ASSERT_THROW(tree.at(2), std::out_of_range); // NOLINT
+}
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <treemap/shardedtreemap.h>
+#include <vector>
+
+TEST(ShardedTreeMap, insertTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(std::vector<int>{10, 20});
+    ASSERT_EQ(true, tree.insert({5, 5}));   // NOLINT
+    ASSERT_EQ(true, tree.insert({25, 25})); // NOLINT
+    ASSERT_EQ(false, tree.insert({5, 0}));  // NOLINT
+    ASSERT_EQ(2, tree.size());              // NOLINT
+    ASSERT_EQ(5, tree.find(5).value());     // NOLINT
+    ASSERT_EQ(false, tree.contains(15));    // NOLINT
+}
+
+TEST(ShardedTreeMap, eraseTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(std::vector<int>{10});
+    tree.insert({3, 3});
+    tree.insert({12, 12});
+    tree.erase(3);
+    tree.erase(12);
+    tree.erase(7);
+    ASSERT_EQ(true, tree.empty()); // NOLINT
+}
+
+TEST(ShardedTreeMap, orderTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(std::vector<int>{10, 20, 30});
+    for (int i = 39; i >= 0; i--) {
+        tree.insert({i, i});
+    }
+    int expected = 0;
+    tree.for_each([&](const std::pair<const int, int>& it) {
+        ASSERT_EQ(expected, it.first); // NOLINT
+        expected++;
+    });
+    ASSERT_EQ(40, expected); // NOLINT
+}
+
+TEST(ShardedTreeMap, rebalanceTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(4);
+    ASSERT_EQ(1, tree.shard_count()); // NOLINT
+    for (int i = 0; i < 5000; i++) {
+        tree.insert({i, i});
+    }
+    ASSERT_LE(4, tree.shard_count());         // NOLINT
+    ASSERT_EQ(5000, tree.size());             // NOLINT
+    ASSERT_EQ(4999, tree.find(4999).value()); // NOLINT
+    tree.rebalance();
+    ASSERT_EQ(4, tree.shard_count());   // NOLINT
+    ASSERT_EQ(0, tree.find(0).value()); // NOLINT
+}
+
+TEST(ShardedTreeMap, sequentialTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(8);
+    for (int i = 0; i < 200000; i++) {
+        tree.insert({i, i});
+    }
+    ASSERT_GE(16, tree.shard_count()); // NOLINT
+    ASSERT_EQ(200000, tree.size());    // NOLINT
+    for (int i = 0; i < 200000; i += 997) {
+        ASSERT_EQ(i, tree.find(i).value()); // NOLINT
+    }
+}
+
+TEST(ShardedTreeMap, slidingWindowTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(8);
+    for (int i = 0; i < 20000; i++) {
+        tree.insert({i, i});
+    }
+    for (int i = 20000; i < 200000; i++) {
+        tree.insert({i, i});
+        tree.erase(i - 20000);
+    }
+    ASSERT_GE(16, tree.shard_count());            // NOLINT
+    ASSERT_EQ(20000, tree.size());                // NOLINT
+    ASSERT_EQ(false, tree.contains(179999));      // NOLINT
+    ASSERT_EQ(180000, tree.find(180000).value()); // NOLINT
+}
+
+TEST(ShardedTreeMap, reentrantTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(4);
+    for (int i = 0; i < 2000; i++) {
+        tree.insert({i * 2, i});
+    }
+    int visited = 0;
+    tree.for_each([&](const std::pair<const int, int>& it) {
+        ASSERT_EQ(true, tree.contains(it.first)); // NOLINT
+        tree.insert({it.first + 1, 0});
+        visited++;
+    });
+    ASSERT_LE(2000, visited);     // NOLINT
+    ASSERT_EQ(4000, tree.size()); // NOLINT
+}
+
+TEST(ShardedTreeMap, concurrentTest)
+{
+    libcsc::ShardedTreeMap<int, int> tree(8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&tree, t] {
+            for (int i = t; i < 20000; i += 4) {
+                tree.insert({i, i});
+            }
+        });
+    }
+    threads.emplace_back([&tree] {
+        for (int i = 0; i < 20; i++) {
+            int last = -1;
+            tree.for_each([&](const std::pair<const int, int>& it) {
+                EXPECT_LT(last, it.first); // NOLINT
+                last = it.first;
+            });
+        }
+    });
+    for (auto& it : threads) {
+        it.join();
+    }
+    ASSERT_EQ(20000, tree.size()); // NOLINT
+    int expected = 0;
+    tree.for_each([&](const std::pair<const int, int>& it) {
+        ASSERT_EQ(expected, it.first); // NOLINT
+        expected++;
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
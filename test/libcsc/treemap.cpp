@@ -1,7 +1,12 @@
 #include <algorithm>
 #include <gtest/gtest.h>
 #include <initializer_list>
+#include <map>
+#include <random>
+#include <string>
 #include <treemap/treemap.h>
+#include <type_traits>
+#include <vector>
 
 TEST(TreeMap, insertTest)
 {
@@ -42,6 +47,14 @@ TEST(TreeMap, containsTest)
     ASSERT_EQ(true, tree.contains(3)); // NOLINT
 }
 
+TEST(TreeMap, constMissingKeyTest)
+{
+    const libcsc::TreeMap<int, int> tree{{2, 2}, {1, 1}, {3, 3}};
+    ASSERT_EQ(false, tree.contains(4));   // NOLINT
+    ASSERT_EQ(0, tree.count(0));          // NOLINT
+    ASSERT_EQ(tree.cend(), tree.find(5)); // NOLINT
+}
+
 TEST(TreeMap, sizeTest)
 {
     libcsc::TreeMap<int, int> tree;
@@ -71,6 +84,18 @@ TEST(TreeMap, moveTest)
     ASSERT_EQ(0, tree.size());       // NOLINT
 }
 
+TEST(TreeMap, assignTest)
+{
+    libcsc::TreeMap<int, int> tree{{3, 3}, {2, 2}, {1, 1}};
+    libcsc::TreeMap<int, int> copy{{5, 5}};
+    copy = tree;
+    ASSERT_EQ(true, tree == copy); // NOLINT
+    libcsc::TreeMap<int, int> moved{{7, 7}};
+    moved = std::move(copy);
+    ASSERT_EQ(true, tree == moved); // NOLINT
+    ASSERT_EQ(0, copy.size());      // NOLINT
+}
+
 TEST(TreeMap, stlTest)
 {
     libcsc::TreeMap<int, int> tree;
@@ -83,6 +108,25 @@ TEST(TreeMap, stlTest)
     ASSERT_EQ(3, it->second); // NOLINT
 }
 
+TEST(TreeMap, reverseTest)
+{
+    libcsc::TreeMap<int, int> tree;
+    ASSERT_THROW(--tree.cend(), std::out_of_range); // NOLINT
+    for (int i = 0; i < 100; i++) {
+        tree.insert({i, i});
+    }
+    int expected = 100;
+    for (auto it = tree.cend(); it != tree.cbegin();) {
+        --it;
+        ASSERT_EQ(--expected, it->first); // NOLINT
+    }
+    ASSERT_EQ(0, expected); // NOLINT
+    auto last = tree.find(99);
+    ++last;
+    ASSERT_EQ(99, (--last)->first);       // NOLINT
+    ASSERT_EQ(99, (--tree.end())->first); // NOLINT
+}
+
 TEST(TreeMap, operatorTest)
 {
     libcsc::TreeMap<int, int> tree;
@@ -104,6 +148,216 @@ TEST(TreeMap, atTest)
     ASSERT_EQ(4, tree.at(4)); // NOLINT
 }
 
+TEST(TreeMap, insertBatchTest)
+{
+    libcsc::TreeMap<int, int> tree;
+    tree.insert({5, 5});
+    std::vector<std::pair<int, int>> batch;
+    for (int i = 9; i >= 0; i--) {
+        batch.emplace_back(i, i * 10);
+    }
+    batch.emplace_back(3, 0);
+    ASSERT_EQ(9, tree.insert_batch(batch)); // NOLINT
+    ASSERT_EQ(10, tree.size());             // NOLINT
+    ASSERT_EQ(5, tree.at(5));               // NOLINT
+    ASSERT_EQ(30, tree.at(3));              // NOLINT
+    int expected = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        ASSERT_EQ(expected, it->first); // NOLINT
+        expected++;
+    }
+}
+
+TEST(TreeMap, insertSmallBatchTest)
+{
+    libcsc::TreeMap<int, int> tree;
+    for (int i = 0; i < 100; i += 2) {
+        tree.insert({i, i});
+    }
+    std::vector<std::pair<int, int>> batch{{7, 7}, {3, 3}, {4, 0}};
+    ASSERT_EQ(2, tree.insert_batch(batch)); // NOLINT
+    ASSERT_EQ(52, tree.size());             // NOLINT
+    ASSERT_EQ(4, tree.at(4));               // NOLINT
+    ASSERT_EQ(7, tree.at(7));               // NOLINT
+}
+
+TEST(TreeMap, scanTest)
+{
+    libcsc::TreeMap<int, int> tree;
+    for (int i = 0; i < 10; i++) {
+        tree.insert({i, i});
+    }
+    std::vector<int> keys;
+    auto collect = [&](const std::pair<const int, int>& it) {
+        keys.push_back(it.first);
+    };
+    auto next = tree.scan(4, collect);
+    ASSERT_EQ(4, next.value()); // NOLINT
+    tree.erase(4);
+    tree.erase(6);
+    while (next) {
+        next = tree.scan(*next, 4, collect);
+    }
+    std::vector<int> expected{0, 1, 2, 3, 5, 7, 8, 9};
+    ASSERT_EQ(expected, keys); // NOLINT
+}
+
+TEST(TreeMap, scanBufferTest)
+{
+    libcsc::TreeMap<int, int> tree;
+    for (int i = 0; i < 5; i++) {
+        tree.insert({i * 2, i});
+    }
+    std::vector<std::pair<int, int>> buffer(2);
+    auto [count, next] = tree.scan(buffer);
+    ASSERT_EQ(2, count);           // NOLINT
+    ASSERT_EQ(0, buffer[0].first); // NOLINT
+    ASSERT_EQ(4, next.value());    // NOLINT
+    std::tie(count, next) = tree.scan(3, buffer);
+    ASSERT_EQ(2, count);           // NOLINT
+    ASSERT_EQ(4, buffer[0].first); // NOLINT
+    ASSERT_EQ(6, buffer[1].first); // NOLINT
+    ASSERT_EQ(8, next.value());    // NOLINT
+    std::tie(count, next) = tree.scan(*next, buffer);
+    ASSERT_EQ(1, count);                // NOLINT
+    ASSERT_EQ(false, next.has_value()); // NOLINT
+    libcsc::TreeMap<int, int> copy;
+    copy.insert_batch(std::span(buffer.data(), count));
+    ASSERT_EQ(4, copy.at(8)); // NOLINT
+}
+
+namespace libcsc {
+template <typename Tree>
+struct TreeMapAccess {
+    // Checks links and ranks of the subtree at node. Every rank difference
+    // must be 1 or 2 and leaves have rank 0; AVL ranks are exact heights
+    // with children differing by at most 1.
+    template <typename Node>
+    static void check(const Node* node, const Node* parent, bool avl)
+    {
+        if (node == nullptr) {
+            return;
+        }
+        ASSERT_EQ(parent, node->parent_); // NOLINT
+        int left = Tree::height(node->left_);
+        int right = Tree::height(node->right_);
+        ASSERT_LE(1, node->height_ - left);  // NOLINT
+        ASSERT_GE(2, node->height_ - left);  // NOLINT
+        ASSERT_LE(1, node->height_ - right); // NOLINT
+        ASSERT_GE(2, node->height_ - right); // NOLINT
+        if (node->left_ == nullptr && node->right_ == nullptr) {
+            ASSERT_EQ(0, node->height_); // NOLINT
+        }
+        if (avl) {
+            ASSERT_EQ(std::max(left, right) + 1, node->height_); // NOLINT
+        }
+        check(node->left_, node, avl);
+        check(node->right_, node, avl);
+    }
+
+    static void check(const Tree& tree, bool avl)
+    {
+        check(tree.root_, decltype(tree.root_)(nullptr), avl);
+    }
+};
+} // namespace libcsc
+
+template <typename Balance>
+void churn()
+{
+    using Tree = libcsc::TreeMap<int, int, Balance>;
+    constexpr bool avl = std::is_same_v<Balance, libcsc::AvlBalance>;
+    std::mt19937 random(1);
+    Tree tree;
+    std::map<int, int> expected;
+    for (int i = 0; i < 20000; i++) {
+        int key = static_cast<int>(random() % 1000);
+        if (i % 1000 == 999) {
+            std::vector<std::pair<int, int>> batch;
+            for (int j = 0; j < 50; j++) {
+                batch.emplace_back(static_cast<int>(random() % 1000), i);
+                expected.insert(batch.back());
+            }
+            tree.insert_batch(batch);
+            libcsc::TreeMapAccess<Tree>::check(tree, avl);
+        } else if (random() % 2 == 0) {
+            tree.insert({key, i});
+            expected.insert({key, i});
+        } else {
+            tree.erase(key);
+            expected.erase(key);
+        }
+        if (i % 100 == 0) {
+            libcsc::TreeMapAccess<Tree>::check(tree, avl);
+        }
+    }
+    libcsc::TreeMapAccess<Tree>::check(tree, avl);
+    ASSERT_EQ(expected.size(), tree.size()); // NOLINT
+    auto it = expected.begin();
+    for (auto node = tree.begin(); node != tree.end(); ++node, ++it) {
+        ASSERT_EQ(*it, *node); // NOLINT
+    }
+}
+
+TEST(TreeMap, avlChurnTest)
+{
+    churn<libcsc::AvlBalance>();
+}
+
+TEST(TreeMap, wavlChurnTest)
+{
+    churn<libcsc::WavlBalance>();
+}
+
+TEST(TreeMap, wavlEraseTest)
+{
+    libcsc::TreeMap<int, int, libcsc::WavlBalance> tree{{3, 3}, {2, 2}, {1, 1}};
+    tree.erase(2);
+    ASSERT_EQ(false, tree.contains(2)); // NOLINT
+    tree.erase(1);
+    tree.erase(3);
+    ASSERT_EQ(true, tree.empty()); // NOLINT
+}
+
+TEST(TreeMap, keyPrefixTest)
+{
+    using StringTree = libcsc::TreeMap<
+            std::string,
+            int,
+            libcsc::AvlBalance,
+            libcsc::StringKeyPrefix>;
+    StringTree tree;
+    std::map<std::string, int> expected;
+    std::vector<std::string> keys{
+            "https://example.com/b",
+            "https://example.com/a",
+            "user",
+            "user42",
+            "",
+            std::string("a\0", 2),
+            "a",
+            "\xff",
+            "https://b.example.com",
+            "https://a.example.com",
+            "0123456789abcdefY",
+            "0123456789abcdefX",
+            "0123456789abcde"};
+    for (size_t i = 0; i < keys.size(); i++) {
+        tree.insert({keys[i], static_cast<int>(i)});
+        expected.insert({keys[i], static_cast<int>(i)});
+    }
+    ASSERT_EQ(expected.size(), tree.size()); // NOLINT
+    auto it = expected.begin();
+    for (auto node = tree.begin(); node != tree.end(); ++node, ++it) {
+        ASSERT_EQ(*it, *node); // NOLINT
+    }
+    ASSERT_EQ(5, tree.at(std::string("a\0", 2)));        // NOLINT
+    ASSERT_EQ(6, tree.at("a"));                          // NOLINT
+    ASSERT_EQ(false, tree.contains("user4"));            // NOLINT
+    ASSERT_EQ(11, tree.at("0123456789abcdefX"));         // NOLINT
+    ASSERT_EQ(false, tree.contains("0123456789abcdef")); // NOLINT
+}
+
 int main(int argc, char* argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);